@@ -0,0 +1,38 @@
+#!/bin/sh
+# Runs each benchmark program with every CPU variant and prints the
+# CPU time (user + system) of the CPU process reported by -t, best of
+# RUNS runs. Every run does the same guest work: the timer variants get a
+# period that never fires, so only the checks compiled into the variant
+# differ. Run from the repository root:
+#   sh bench/run_bench.sh
+# CC and CFLAGS pick the compiler and flags, RUNS the number of runs.
+
+CC=${CC:-cc}
+CFLAGS=${CFLAGS:--O2}
+RUNS=${RUNS:-5}
+build=$(mktemp -d) || exit 1
+trap 'rm -rf "$build"' EXIT
+
+$CC $CFLAGS -o "$build/simulation" simulation.c || exit 1
+
+#best name options... runs the simulation RUNS times and prints the best CPU time
+best(){
+	name=$1
+	shift
+	i=0
+	while [ $i -lt "$RUNS" ]; do
+		"$build/simulation" -t "$@" 2>&1 >/dev/null | grep "CPU process time"
+		i=$((i + 1))
+	done | awk -v name="$name" -v prog="$prog" '
+		{ if(NR == 1 || $5 + $8 < total) total = $5 + $8 }
+		END { printf "%-6s %-20s %.3f s\n", prog, name, total }'
+}
+
+for prog in alu calls data; do
+	file=bench/$prog.txt
+	best "timer+protect" "$file" 1000000000
+	best "no timer" "$file" 0
+	best "no protect" -u "$file" 1000000000
+	best "no timer/protect" -u "$file" 0
+	best "timer+protect+prof" -p "$build/profile.txt" "$file" 1000000000
+done
@@ -0,0 +1,128 @@
+/*
+* Isaac Cardoso
+* This program reads a guest profile written by "simulation -p" and
+* prints how much host CPU time was spent in each guest routine.
+* A routine starts at one of the entry addresses in the profile and
+* ends at the next entry, user and system memory are never mixed.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//function declarations
+void error_exit(char *s);
+const char *routineName(int entry, char *buff);
+
+/*
+********************************************************************************
+********************************** main ****************************************
+********************************************************************************
+*/
+int main(int argc, char *argv[])
+{
+	//check if number of arguments is 2
+	if(argc != 2){//if not, exit with error message
+		error_exit("Usage: profreport profileFile");
+	}
+
+	FILE *file = fopen(argv[1], "r");
+	if(file == NULL)
+		error_exit("Profile file does not exist");
+
+	//variables
+	int interval = 1000;//microseconds per sample
+	int isEntry[2000] = {0};//1 if a routine starts at that address
+	unsigned long samples[2000] = {0};//samples per guest address
+	unsigned long outside = 0;//samples taken outside of guest instructions
+	unsigned long total = 0;//all samples
+	int addr;
+	unsigned long count;
+	char buff[255];
+
+	//read the profile
+	while(fgets(buff, 255, file) != NULL){
+		if(sscanf(buff, "interval %d", &interval) == 1)
+			continue;
+		else if(sscanf(buff, "entry %d", &addr) == 1){
+			if(addr >= 0 && addr < 2000)
+				isEntry[addr] = 1;
+		}
+		else if(sscanf(buff, "sample %d %lu", &addr, &count) == 2){
+			if(addr >= 0 && addr < 2000)
+				samples[addr] += count;
+			else
+				outside += count;
+			total += count;
+		}
+	}
+	fclose(file);
+
+	//the start of each memory half is always a routine
+	isEntry[0] = 1;
+	isEntry[1000] = 1;
+
+	//add up the samples of each routine
+	int entries[2000];//routine entry addresses
+	unsigned long routineSamples[2000];//samples per routine
+	int numRoutines = 0;
+	for(addr = 0; addr < 2000; addr++){
+		if(isEntry[addr]){
+			entries[numRoutines] = addr;
+			routineSamples[numRoutines] = 0;
+			numRoutines++;
+		}
+		routineSamples[numRoutines - 1] += samples[addr];
+	}
+
+	//sort the routines by samples, most expensive first
+	int i, j;
+	for(i = 1; i < numRoutines; i++){
+		int tempEntry = entries[i];
+		unsigned long tempSamples = routineSamples[i];
+		for(j = i - 1; j >= 0 && routineSamples[j] < tempSamples; j--){
+			entries[j + 1] = entries[j];
+			routineSamples[j + 1] = routineSamples[j];
+		}
+		entries[j + 1] = tempEntry;
+		routineSamples[j + 1] = tempSamples;
+	}
+
+	//print the report
+	printf("%-18s %6s %10s %10s %7s\n", "routine", "entry", "samples", "ms", "%");
+	for(i = 0; i < numRoutines; i++){
+		if(routineSamples[i] == 0)
+			continue;
+		printf("%-18s %6d %10lu %10.1f %6.1f%%\n", routineName(entries[i], buff), entries[i],
+			routineSamples[i], routineSamples[i] * interval / 1000.0,
+			100.0 * routineSamples[i] / total);
+	}
+	if(outside)
+		printf("%-18s %6s %10lu %10.1f %6.1f%%\n", "[outside guest]", "-", outside,
+			outside * interval / 1000.0, 100.0 * outside / total);
+	printf("%-18s %6s %10lu %10.1f\n", "total", "", total, total * interval / 1000.0);
+
+	return 0;
+}
+//***************************** End of main ****************************************
+//**********************************************************************************
+
+//Print error message on the screen and exit
+void error_exit(char *s){
+   fprintf(stderr,"\nERROR: %s\n", s);
+      exit(1);
+}
+
+/*
+* Returns the name of the routine starting at entry, the handlers
+* and the user program have fixed names, other routines are sub_<entry>.
+*/
+const char *routineName(int entry, char *buff){
+	if(entry == 0)
+		return "main";
+	if(entry == 1000)
+		return "timer_handler";
+	if(entry == 1500)
+		return "syscall_handler";
+	sprintf(buff, "sub_%d", entry);
+	return buff;
+}
@@ -11,11 +11,91 @@
 #include <sys/wait.h>
 #include <string.h>
 #include <time.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <errno.h>
+
+/*
+* Memory protocol. Every message from the CPU starts with three words:
+* the message type, an address and a word count. A write message is followed
+* by count data words and the memory answers a read message with count words.
+* The first message is always a hello with the protocol version as its address.
+*/
+#define PROTOCOL_VERSION 2
+#define MSG_END -1
+#define MSG_READ 0
+#define MSG_WRITE 1
+#define MSG_HELLO 2
+//version the CPU sends in its hello message, only changed to test the version check
+#ifndef CPU_PROTOCOL_VERSION
+#define CPU_PROTOCOL_VERSION PROTOCOL_VERSION
+#endif
+#define MAX_MESSAGE_WORDS 64//largest count allowed in one message
+#define MESSAGE_BUFFER_SIZE 1024//words the memory reads or answers at once
+
+//runCPU must be inlined into every variant, other compilers only get the inline hint
+#ifdef __GNUC__
+#define ALWAYS_INLINE __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE
+#endif
+
+//words fetched together starting at the PC, enough for the opcode, the operand and the next instructions
+#define FETCH_SIZE 8
+//stores the CPU holds before sending them to the memory
+#define STORE_BUFFER_SIZE 32
+
+//CPU side of the connection to the memory
+struct memoryPort {
+	int readFd;//answers from the memory
+	int writeFd;//messages to the memory
+	int fetchBase;//address of the first word in the fetch window
+	int fetchCount;//number of words in the fetch window
+	int fetchWords[FETCH_SIZE];//words starting at fetchBase, kept up to date by portWrite
+	int prefetchAddr;//next instruction address given by portPrefetch, -1 if none
+	int numStores;//number of stores in the store buffer
+	int storeAddr[STORE_BUFFER_SIZE];//address of each buffered store, each address appears once
+	int storeData[STORE_BUFFER_SIZE];//data of each buffered store
+};
+
+//signature shared by all CPU variants
+typedef void (*cpuFunction)(int readFd, int writeFd, int timeToInterrupt);
 
 //function declarations
+cpuFunction selectCPU(int timer, int protect, int profile);
 void error_exit(char *s);
+void memory_error_exit(char *s, int readFd, int writeFd);
 int readMem(int arr[], int address);
 void writeMem(int arr[], int address, int data);
+void profileTick(int sig, siginfo_t *info, void *context);
+void startProfiler(void);
+void writeProfile(void);
+void portOpen(struct memoryPort *port, int readFd, int writeFd);
+void portSend(struct memoryPort *port, int *message, int messageWords);
+void portReceive(struct memoryPort *port, int *dst, int count);
+int portLookup(struct memoryPort *port, int address, int *data);
+int portInWindow(struct memoryPort *port, int address);
+int portWindowSize(int address);
+int portFetch(struct memoryPort *port, int address);
+void portPrefetch(struct memoryPort *port, int address);
+int portRead(struct memoryPort *port, int address);
+void portReadWords(struct memoryPort *port, int address, int count, int *dst);
+void portWrite(struct memoryPort *port, int address, int data);
+void portClose(struct memoryPort *port);
+void stopCPU(struct memoryPort *port);
+void memoryStopped(void);
+
+//host CPU time between two profile samples in microseconds
+#define PROFILE_INTERVAL 1000
+
+//guest profiling variables, only used by the CPU process when -p is given
+FILE *profileOut = NULL;//profile file, opened before the CPU starts
+timer_t profileTimer;//sends SIGPROF after each PROFILE_INTERVAL of CPU time
+volatile sig_atomic_t guestPC = -1;//address of the instruction being executed
+volatile unsigned long profileSamples[2001];//samples per guest address, last entry is for samples outside memory
+int routineEntry[2000];//1 if a routine starts at that address
 
 /*
 ********************************************************************************
@@ -24,22 +104,51 @@ void writeMem(int arr[], int address, int data);
 */
 int main(int argc, char *argv[])
 {
-	//check if number of arguments is 3
-	if(argc != 3){//if not, exit with error message
+	char *profileFile = NULL;//where to write the guest profile, NULL if not profiling
+	int protect = 1;//user mode cannot access system memory unless -u is given
+	int showTime = 0;//print the CPU time used by the CPU process if -t is given
+	int option;
+
+	//read the options
+	//stop at the input file, so a negative timer is not read as an option
+	while((option = getopt(argc, argv, "+p:ut")) != -1){
+		if(option == 'p')
+			profileFile = optarg;
+		else if(option == 'u')
+			protect = 0;
+		else if(option == 't')
+			showTime = 1;
+		else
+			error_exit("Usage: simulation [-p profileFile] [-u] [-t] inputFile timer");
+	}
+
+	//check if number of arguments left is 2
+	if(argc - optind != 2){//if not, exit with error message
 		error_exit("Invalid number of arguments");
 	}
 
 	//check if input file exists
-	if(access(argv[1], F_OK) == -1){//if not, exit with error message
+	if(access(argv[optind], F_OK) == -1){//if not, exit with error message
 		error_exit("Input file does not exist");
 	}
 
 	//variables
-	int timeToInterrupt = atoi(argv[2]);//time to interrupt 
-	int interruptCounter = 0;//increases after execution of an instruction
+	char *inputFile = argv[optind];//user program
+	int timeToInterrupt = atoi(argv[optind + 1]);//time to interrupt, no timer if not positive
+	cpuFunction cpu;//interpreter specialized for the options
 	int result;//to store the result of the fork
 
 
+	//open the profile now, so a bad file name stops the program before it runs
+	if(profileFile != NULL){
+		profileOut = fopen(profileFile, "w");
+		if(profileOut == NULL)
+			error_exit("Could not open profile file");
+	}
+
+	//choose the CPU variant before forking
+	cpu = selectCPU(timeToInterrupt > 0, protect, profileOut != NULL);
+
 	//create pipes to share data between processes
 	int pipe1[2];
 	int pipe2[2];
@@ -65,536 +174,8 @@ int main(int argc, char *argv[])
 		close(pipe1[1]);
 		close(pipe2[0]);
 
-		//child variables
-		int mode; // kernel mode(0), user mode(1)
-		int inInterrupt;//block interrupts when equal to 1
-		int SP, PC, IR, AC, X, Y;//CPU registers
-		int operand;//to store other data from program
-		int tempSP;//tem holder for stack pointer
-		int r,w;//read and write signals to send to parent
-		int endSignal = -1;//lets the parent know it's done sending signals
-
-		//initialize registers and variables
-		PC = 0;//point to the first instruction of program
-		SP = 999; //point to the begining of the user stack
-		AC = 0;
-		X = 0;
-		Y = 0;
-		operand = 0;
-		mode = 1; //user mode
-		inInterrupt = 0;//in interrupt to false
-		r = 0;//read signal
-		w = 1; //write signal
-
-		//fetch the first instruction
-		write(pipe2[1], &r, sizeof(int));//send the read signal
-		write(pipe2[1], &PC, sizeof(int));//send the location
-		read(pipe1[0], &IR, sizeof(int));//read the response and store into IR
-
-		//exit loop when the END(50) instruction is reached
-		while(IR != 50){
-			//do according to the instruction number
-			switch(IR){
-				//********************************************************
-				//		1.	Load value:	Load the value into the AC
-				//********************************************************
-				case 1: 
-					PC++; //increase PC by 1
-					//get the value to load into AC
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &AC, sizeof(int));//store value into AC
-					PC++;
-					break;
-
-				//*********************************************************
-				//	2. Load addr: Load the value at the address into the AC
-				//*********************************************************
-				case 2:
-					PC++; //increase PC by 1
-					//get the address
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-
-					//check for memory violation
-					if(mode && (operand >= 1000)){
-						//send end signal so parent can stop waiting for signals
-						write(pipe2[1], &endSignal, sizeof(int));
-						//display error message
-						printf("Memory violation: accessing system address %d in user mode\n", operand);
-						_exit(0);//terminate child process
-					}
-
-					//get the value to store into AC
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &operand, sizeof(int));//send the location
-					read(pipe1[0], &AC, sizeof(int));//store value into AC
-					PC++;
-					break;
-
-				//********************************************************
-				//	3. LoadInd addr: Load the value from the address found 
-				// 	    in the given address into the AC
-				//********************************************************
-				case 3:
-					PC++; //increase PC by 1
-					//get the address
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-
-					//check for memory violation
-					if(mode && (operand >= 1000)){
-						//send end signal so parent can stop waiting for signals
-						write(pipe2[1], &endSignal, sizeof(int));
-						//display error message
-						printf("Memory violation: accessing system address %d in user mode\n", operand);
-						_exit(0);//terminate child process
-					}
-
-					//get the value at address stored in operand
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &operand, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand again
-					//get the value at location stored in operand
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &operand, sizeof(int));//send the location
-					read(pipe1[0], &AC, sizeof(int));//store value into AC
-					PC++;
-					break;
-
-				//********************************************************
-				//	4. LoadIdxX addr: Load the value at (address+X) 
-				//	   into the AC
-				//********************************************************
-				case 4:
-					PC++; //increase PC by 1
-					//get the address
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-
-					//check for memory violation
-					if(mode && (operand >= 1000)){
-						//send end signal so parent can stop waiting for signals
-						write(pipe2[1], &endSignal, sizeof(int));
-						//display error message
-						printf("Memory violation: accessing system address %d in user mode\n", operand);
-						_exit(0);//terminate child process
-					}
-
-					//(address+X)
-					operand = operand + X;
-
-					//get the value at location operand from memory
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &operand, sizeof(int));//send the location
-					read(pipe1[0], &AC, sizeof(int));//store value into AC
-					PC++;
-					break;
-
-				//********************************************************
-				//	5. LoadIdxY addr: Load the value at (address+Y)
-				//     into the AC
-				//********************************************************
-				case 5:
-					PC++; //increase PC by 1
-					//get the address
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-
-					//check for memory violation
-					if(mode && (operand >= 1000)){
-						//send end signal so parent can stop waiting for signals
-						write(pipe2[1], &endSignal, sizeof(int));
-						//display error message
-						printf("Memory violation: accessing system address %d in user mode\n", operand);
-						_exit(0);//terminate child process
-					}
-					
-					operand = operand + Y; ////(address+Y)
-
-					//get the value at location operand from memory
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &operand, sizeof(int));//send the location
-					read(pipe1[0], &AC, sizeof(int));//store value into AC
-					PC++;
-					break;
-
-				//********************************************************
-				//	6. LoadSpX: Load from (SP+X) into the AC
-				//********************************************************
-				case 6:
-					PC++; //increase PC by 1
-					operand = SP + X; // (SP + X)
-					//get the value at location operand from memory
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &operand, sizeof(int));//send the location
-					read(pipe1[0], &AC, sizeof(int));//store value into AC
-					break;
-
-				//***********************************************************
-				//	7. Store addr: Store the value in the AC into the address
-				//***********************************************************
-				case 7:
-					PC++; //increase PC by 1
-					//get the addres
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-
-					//check for memory violation
-					if(mode && (operand >= 1000)){
-						//send end signal so parent can stop waiting for signals
-						write(pipe2[1], &endSignal, sizeof(int));
-						printf("Memory violation: accessing system address %d in user mode\n", operand);
-						_exit(0);
-					}
-
-					//send address and data to be written into memory to the parent process
-					write(pipe2[1], &w, sizeof(int));//send write signal
-					write(pipe2[1], &operand, sizeof(int));//send the address
-					write(pipe2[1], &AC, sizeof(int));//send data stored in AC
-					PC++;
-					break;
-
-				//********************************************************
-				//	8. Get: Gets a random int from 1 to 100 into the AC
-				//********************************************************
-				case 8: 
-					PC++; //increase PC by 1
-					srand(time(NULL));
-					AC = rand() % 101;//generate random number
-					if(AC == 0)//if 0 was generated change to 1
-						AC = 1;
-					break;
-
-				//********************************************************
-				//	9. Put port: Write AC as int or char depending on port
-				//********************************************************
-				case 9:
-					PC++; //increase PC by 1
-					//get the port
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-
-					//If port=1, write AC as an int to the screen
-					if(operand == 1){
-						printf("%d", AC);
-					}
-					//If port=2, write AC as a char to the screen
-					else if(operand == 2){
-						printf("%c", (char)AC);
-					}
-					PC++;
-					break;
-
-				//********************************************************
-				//	10. AddX: Add the value in X to the AC
-				//********************************************************
-				case 10: 
-					PC++; //increase PC by 1
-					AC = AC + X;
-					break;
-
-				//********************************************************
-				//	11. AddY: Add the value in Y to the AC
-				//********************************************************
-				case 11:
-					PC++; //increase PC by 1
-					AC = AC + Y;
-					break;
-
-				//********************************************************
-				//	12. SubX: Subtract the value in X from the AC
-				//********************************************************
-				case 12: 
-					PC++; //increase PC by 1
-					AC = AC - X;
-					break;
-
-				//********************************************************
-				//	13. SubY: Subtract the value in Y from the AC
-				//********************************************************
-				case 13: 
-					PC++; //increase PC by 1
-					AC = AC - Y;
-					break;
-
-				//********************************************************
-				//	14. CopyToX: Copy the value in the AC to X
-				//********************************************************
-				case 14:
-					PC++; //increase PC by 1
-					X = AC;
-					break;
-
-				//********************************************************
-				//	15. CopyFromX : Copy the value in X to the AC
-				//********************************************************
-				case 15:
-					PC++; //increase PC by 1
-					AC = X;
-					break;
-
-				//********************************************************
-				//	16. CopyToY: Copy the value in the AC to Y
-				//********************************************************
-				case 16: 
-					PC++; //increase PC by 1
-					Y = AC;
-					break;
-
-				//********************************************************
-				//	17. CopyFromY: Copy the value in Y to the AC
-				//********************************************************
-				case 17: 
-					PC++; //increase PC by 1
-					AC = Y;
-					break;
-
-				//********************************************************
-				//	18. CopyToSp: Copy the value in AC to the SP
-				//********************************************************
-				case 18:
-					PC++; //increase PC by 1
-					SP = AC;
-					break;
-
-				//********************************************************
-				//	19. CopyFromSp: Copy the value in SP to the AC
-				//********************************************************
-				case 19: 
-					PC++; //increase PC by 1
-					AC = SP;
-					break;
-
-				//********************************************************
-				//	20. Jump addr: Jump to the address
-				//********************************************************
-				case 20: 
-					PC++; //increase PC by 1
-					//get the address
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-					PC = operand; //value in operand is the new PC
-					break;
-
-				//********************************************************
-				//	21. JumpIfEqual addr: Jump to the address only 
-				//      if the value in the AC is zero
-				//********************************************************
-				case 21:
-					PC++; //increase PC by 1
-					if(AC == 0){
-						//get the address
-						write(pipe2[1], &r, sizeof(int));//send read signal
-						write(pipe2[1], &PC, sizeof(int));//send the location
-						read(pipe1[0], &operand, sizeof(int));//store value into operand
-						PC = operand;
-					}
-					else{
-						PC++; //increase PC by 1
-					}
-					break;
-
-				//********************************************************
-				//	22. JumpIfNotEqual addr: Jump to the address only 
-				//      if the value in the AC is not zero
-				//********************************************************
-				case 22: 
-					PC++; //increase PC by 1
-					//get the address
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-					if(AC != 0)
-						PC = operand;
-					else
-						PC++;
-					break;
-
-				//********************************************************
-				//	23. Call addr: Push return address onto stack, 
-				//      jump to the address
-				//********************************************************
-				case 23: 
-					PC++; //increase PC by 1
-					//get the address
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &PC, sizeof(int));//send the location
-					read(pipe1[0], &operand, sizeof(int));//store value into operand
-
-					PC++; //return addres
-
-					//push return address onto user stack
-					SP--;//decrement stack pointer before push
-					write(pipe2[1], &w, sizeof(int));//send write signal
-					write(pipe2[1], &SP, sizeof(int));//send the address
-					write(pipe2[1], &PC, sizeof(int));//send data stored in PC
-
-					PC = operand; // update PC to the intruction to jump to
-					break;
-
-				//********************************************************
-				//	24. Ret: Pop return address from the stack, 
-				//      jump to the address
-				//********************************************************
-				case 24:
-					PC++; //increase PC by 1
-					//pop return address from location at SP
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &SP, sizeof(int));//send the location
-					read(pipe1[0], &PC, sizeof(int));//store into PC 
-					SP++;//increment stack pointer after pop
-					break;
-
-				//********************************************************
-				//	25. IncX: Increment the value in X
-				//********************************************************
-				case 25: 
-					PC++; //increase PC by 1
-					X = X + 1;
-					break;
-
-				//********************************************************
-				//	26. DecX: Decrement the value in X
-				//********************************************************
-				case 26: 
-					PC++; //increase PC by 1
-					X = X - 1;
-					break;
-
-				//********************************************************
-				//	27. Push: Push AC onto stack
-				//********************************************************
-				case 27: 
-					PC++; //increase PC by 1
-					SP--;//decrement stack pointer before push
-					write(pipe2[1], &w, sizeof(int));//send write signal
-					write(pipe2[1], &SP, sizeof(int));//send the address
-					write(pipe2[1], &AC, sizeof(int));//send data stored in AC
-					break;
-
-				//********************************************************
-				//	28. Pop: Pop from stack into AC
-				//********************************************************
-				case 28: 
-					PC++; //increase PC by 1
-					//pop value from stack at location SP and store it in AC
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &SP, sizeof(int));//send the location
-					read(pipe1[0], &AC, sizeof(int));//store value into AC
-					SP++;//increment stack pointer after pop
-					break;
-
-				//********************************************************
-				//	29. Int: Perform system call
-				//********************************************************
-				case 29: 
-					PC++; //increase PC by 1
-					if(inInterrupt)//avoid nested interrupts
-						break;
-
-					mode = 0; //enter kernel mode
-					tempSP = SP; //temporarily hold current stack pointer value
-					SP = 1999; //point to the system stack
-					inInterrupt = 1; //set in interrupt flag to avoid nested interrupts
-
-					//Save SP, PC onto the system stack
-					//push current SP value temporarily held in tempSP onto sys stack
-					SP--;//decrement stack pointer before push
-					write(pipe2[1], &w, sizeof(int));//send write signal
-					write(pipe2[1], &SP, sizeof(int));//send the address
-					write(pipe2[1], &tempSP, sizeof(int));//send data stored in tempSP
-
-					//push current PC value onto sys stack
-					SP--;//decrement stack pointer before push
-					write(pipe2[1], &w, sizeof(int));//send read signal
-					write(pipe2[1], &SP, sizeof(int));//send the address
-					write(pipe2[1], &PC, sizeof(int));//send data stored in PC
-
-					PC = 1500; //execute from address 1500
-					break;
-
-				//********************************************************
-				//	30. IRet: Return from interrupt
-				//********************************************************
-				case 30: 
-					//pop PC from sys stack and store in PC
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &SP, sizeof(int));//send the location
-					read(pipe1[0], &PC, sizeof(int));//store value into PC
-					SP++;//increment stack pointer after pop
-
-					//pop user SP from sys stack and store in tempSP
-					write(pipe2[1], &r, sizeof(int));//send read signal
-					write(pipe2[1], &SP, sizeof(int));//send the location
-					read(pipe1[0], &tempSP, sizeof(int));//store value into tempSP
-					SP++;//increment stack pointer after pop
-
-					SP = tempSP;//point to the user stack
-
-					mode = 1; //chage to user mode
-					inInterrupt = 0; //enable interrupts
-					break;
-
-					default:
-						//invalid instruction
-						//send end signal
-						write(pipe2[1], &endSignal, sizeof(int));
-						//print error message
-						error_exit("Invalid instruction");
-
-			}//end switch case statements
-
-			//if not currently executing an interrupt, increase counter
-			if(!inInterrupt)
-				interruptCounter++;
-
-			//check for timer interrupts
-			if(interruptCounter == timeToInterrupt){
-
-				if(inInterrupt){//avoid nested interrupts
-					//do nothing
-				}
-				else{
-					interruptCounter = -1;//reset counter
-					mode = 0; //enter kernel mode
-					tempSP = SP; //temporarily hold current stack pointer value
-					SP = 1999; //point to the system stack
-					inInterrupt = 1; //set in interrupt flag to avoid nested interrupts
-
-					//Save SP, PC and the system stack
-					//push current SP value temporarily held in tempSP onto sys stack
-					SP--; //decrement stack pointer before push
-					write(pipe2[1], &w, sizeof(int));//send write signal
-					write(pipe2[1], &SP, sizeof(int));//send the address
-					write(pipe2[1], &tempSP, sizeof(int));//send data stored in operand
-
-					//push current PC value onto sys stack
-					SP--; //decrement stack pointer before push
-					write(pipe2[1], &w, sizeof(int));//send read signal
-					write(pipe2[1], &SP, sizeof(int));//send the address
-					write(pipe2[1], &PC, sizeof(int));//send data stored in PC
-
-					PC = 1000; //execute from address 1000
-				}
-			}
-
-			//fetch the next instruction
-			write(pipe2[1], &r, sizeof(int));//send the read signal
-			write(pipe2[1], &PC, sizeof(int));//send the location
-			read(pipe1[0], &IR, sizeof(int));//read the response and store it in IR
-
-		}//end while loop
-
-		//send end signal so parent can stop waiting for signals
-		write(pipe2[1], &endSignal, sizeof(int));
+		//run the interpreter built for the given options
+		cpu(pipe1[0], pipe2[1], timeToInterrupt);
 	}//end of child process
 	//****************************************************************************************
 
@@ -614,8 +195,8 @@ int main(int argc, char *argv[])
 
 		//get the input file name from argument list
 		//store it in fileName
-		fileName = malloc(strlen(argv[1]));
-		strcat(fileName, argv[1]);
+		fileName = malloc(strlen(inputFile) + 1);//room for the terminating null
+		strcpy(fileName, inputFile);
 
 		//open file for reading
 		FILE *file;
@@ -648,42 +229,96 @@ int main(int argc, char *argv[])
 	    	}
 	    }//end while
 
+	    //buffers for the messages from the child and the answers to it
+	    int in[MESSAGE_BUFFER_SIZE];//messages received from child
+	    int inBytes = 0;//bytes in the receive buffer
+	    int out[MESSAGE_BUFFER_SIZE];//answers to send to child
+	    int outWords;//words in the answer buffer
+	    int pos;//word where the next message starts
+	    int bytes;//bytes received by the last read
+	    int version = 0;//protocol version sent by child, 0 until the hello message
+	    int done = 0;//1 after the end message
+
 	    //local variables to store values to pass as parameters to read/write function
-	    int signal; 
+	    int type;
 	    int addr; 
-	    int data;
-
-	    //get signal from child
-	    read(pipe2[0], &signal, sizeof(int));
-
-	    while(signal != -1){
-	    	if(signal == 0){ //read from memory
-	    		read(pipe2[0], &addr, sizeof(int));
-	    		if(addr > 1999)
-	    			error_exit("Memory Violation. Out of bounds");
-	    		else{
-	    			data = readMem(memory, addr);
-	    			write(pipe1[1], &data, sizeof(int));
+	    int count;
+	    int i;
+
+	    while(!done){
+	    	//get all the messages child has sent so far
+	    	bytes = read(pipe2[0], (char *)in + inBytes, sizeof(in) - inBytes);
+	    	if(bytes <= 0)//child is gone
+	    		break;
+	    	inBytes += bytes;
+
+	    	//handle every complete message
+	    	pos = 0;
+	    	outWords = 0;
+	    	while(!done && inBytes / (int)sizeof(int) - pos >= 3){
+	    		type = in[pos];
+	    		addr = in[pos + 1];
+	    		count = in[pos + 2];
+
+	    		if(type == MSG_HELLO){//check the protocol version
+	    			if(addr != PROTOCOL_VERSION)
+	    				memory_error_exit("Unsupported memory protocol version", pipe2[0], pipe1[1]);
+	    			version = addr;
+	    			pos += 3;
+	    			continue;
+	    		}
+	    		if(version == 0)
+	    			memory_error_exit("Memory protocol version not sent", pipe2[0], pipe1[1]);
+
+	    		if(type == MSG_END){
+	    			done = 1;
+	    			break;
+	    		}
+	    		if(count < 1 || count > MAX_MESSAGE_WORDS)
+	    			memory_error_exit("Invalid memory message", pipe2[0], pipe1[1]);
+	    		if(addr < 0 || addr > 2000 - count)//count is checked, so this cannot overflow
+	    			memory_error_exit("Memory Violation. Out of bounds", pipe2[0], pipe1[1]);
+
+	    		if(type == MSG_READ){ //read from memory
+	    			//make room for the answer
+	    			if(outWords + count > MESSAGE_BUFFER_SIZE){
+	    				write(pipe1[1], out, outWords * sizeof(int));
+	    				outWords = 0;
+	    			}
+	    			for(i = 0; i < count; i++)
+	    				out[outWords++] = readMem(memory, addr + i);
+	    			pos += 3;
+	    		}
+	    		else if(type == MSG_WRITE){ // write to memory
+	    			//wait for the rest of the data
+	    			if(inBytes / (int)sizeof(int) - pos < 3 + count)
+	    				break;
+	    			for(i = 0; i < count; i++)
+	    				writeMem(memory, addr + i, in[pos + 3 + i]);
+	    			pos += 3 + count;
+	    		}
+	    		else
+	    			memory_error_exit("Invalid memory message", pipe2[0], pipe1[1]);
 	    	}
 
-	    	}
-	    	else if(signal == 1){ // write to memory
-	    		read(pipe2[0], &addr, sizeof(int));
-	    		if(addr > 1999)
-	    			error_exit("Memory Violation. Out of bounds");
-	    		else{
-		    		read(pipe2[0], &data, sizeof(int));
-		    		writeMem(memory, addr, data);
-		    	}
-	    	}
-	    	//get next signal from child
-	    	read(pipe2[0], &signal, sizeof(int));
+	    	//send all the answers at once
+	    	if(outWords > 0)
+	    		write(pipe1[1], out, outWords * sizeof(int));
+
+	    	//keep the part of a message that has not fully arrived
+	    	inBytes -= pos * sizeof(int);
+	    	memmove(in, &in[pos], inBytes);
 	    }//end while
 
 	}
 
 	//wait for child process to end
-	waitpid(-1, NULL, 0);
+	struct rusage usage;//CPU time used by the child
+	if(wait4(-1, NULL, 0, &usage) == result && showTime){
+		fprintf(stderr, "CPU process time: user %ld.%06ld s, system %ld.%06ld s\n",
+			(long)usage.ru_utime.tv_sec, (long)usage.ru_utime.tv_usec,
+			(long)usage.ru_stime.tv_sec, (long)usage.ru_stime.tv_usec);
+	}
 	return 0;
 }
 //***************************** End of main ****************************************
@@ -695,6 +330,18 @@ void error_exit(char *s){
       exit(1);
 }
 
+/*
+* Used by the memory instead of error_exit. Closes the pipes so the CPU
+* stops too and waits for it, so its profile is written before the program ends.
+*/
+void memory_error_exit(char *s, int readFd, int writeFd){
+	fprintf(stderr,"\nERROR: %s\n", s);
+	close(readFd);
+	close(writeFd);
+	waitpid(-1, NULL, 0);
+	exit(1);
+}
+
 /* 
 * Takes an int array and an integer as its parameters 
 * and returns the data from the array at that integer location. 
@@ -711,3 +358,873 @@ int readMem(int arr[], int address){
 void writeMem(int arr[], int address, int data){
 	arr[address] = data;
 }
+
+/*
+* Signal handler for SIGPROF. Counts the samples for the guest
+* instruction that was running when the host CPU time ran out.
+* The kernel merges expirations that happen between two signals,
+* timer_getoverrun tells how many were merged.
+*/
+void profileTick(int sig, siginfo_t *info, void *context){
+	int pc = guestPC;
+	int overrun = timer_getoverrun(profileTimer);
+	(void)sig;
+	(void)info;
+	(void)context;
+	if(pc < 0 || pc > 1999)//not executing a guest instruction
+		pc = 2000;
+	profileSamples[pc] += 1 + (overrun > 0 ? overrun : 0);
+}
+
+/*
+* Starts sampling the host CPU time used by this process.
+* The entry points of the user program and of both handlers are
+* always routines, other routines are found when they are called.
+*/
+void startProfiler(void){
+	struct sigaction action;
+	struct sigevent event;
+	struct itimerspec timer;
+
+	routineEntry[0] = 1;//user program
+	routineEntry[1000] = 1;//timer interrupt handler
+	routineEntry[1500] = 1;//system call handler
+
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = profileTick;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;//do not break the pipe reads
+	sigemptyset(&action.sa_mask);
+	if(sigaction(SIGPROF, &action, NULL) == -1)
+		error_exit("sigaction() failed");
+
+	memset(&event, 0, sizeof(event));
+	event.sigev_notify = SIGEV_SIGNAL;
+	event.sigev_signo = SIGPROF;
+	if(timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &profileTimer) == -1)
+		error_exit("timer_create() failed");
+
+	timer.it_interval.tv_sec = 0;
+	timer.it_interval.tv_nsec = PROFILE_INTERVAL * 1000;
+	timer.it_value = timer.it_interval;
+	if(timer_settime(profileTimer, 0, &timer, NULL) == -1)
+		error_exit("timer_settime() failed");
+}
+
+/*
+* Stops the profiler and writes the samples to the profile file so
+* profreport can group them by guest routine. Each line is either
+* "interval <microseconds>", "entry <address>" or "sample <address> <count>",
+* address -1 holds the samples taken outside of guest instructions.
+*/
+void writeProfile(void){
+	int i;
+
+	timer_delete(profileTimer);
+
+	fprintf(profileOut, "interval %d\n", PROFILE_INTERVAL);
+	for(i = 0; i < 2000; i++){
+		if(routineEntry[i])
+			fprintf(profileOut, "entry %d\n", i);
+	}
+	for(i = 0; i < 2000; i++){
+		if(profileSamples[i])
+			fprintf(profileOut, "sample %d %lu\n", i, profileSamples[i]);
+	}
+	if(profileSamples[2000])
+		fprintf(profileOut, "sample -1 %lu\n", profileSamples[2000]);
+	fclose(profileOut);
+	profileOut = NULL;
+}
+
+/*
+* Initializes the connection to the memory and
+* sends the hello message with the protocol version.
+*/
+void portOpen(struct memoryPort *port, int readFd, int writeFd){
+	int hello[3] = {MSG_HELLO, CPU_PROTOCOL_VERSION, 0};
+
+	port->readFd = readFd;
+	port->writeFd = writeFd;
+	port->fetchBase = 0;
+	port->fetchCount = 0;
+	port->prefetchAddr = -1;
+	port->numStores = 0;
+
+	//a write after the memory stopped fails instead of killing the CPU, see memoryStopped
+	signal(SIGPIPE, SIG_IGN);
+	portSend(port, hello, 3);
+}
+
+/*
+* Sends the buffered stores followed by message with one writev.
+* The memory applies the stores before it handles the message, so a read
+* always sees the stores made before it. Stores to consecutive addresses
+* are sent as one write message. message can be NULL to only flush the stores.
+*/
+void portSend(struct memoryPort *port, int *message, int messageWords){
+	int stores[STORE_BUFFER_SIZE * 4];//write messages for the buffered stores
+	int storeWords = 0;
+	struct iovec iov[2];
+	int i, j, tempAddr, tempData;
+
+	//sort the stores by address
+	for(i = 1; i < port->numStores; i++){
+		tempAddr = port->storeAddr[i];
+		tempData = port->storeData[i];
+		for(j = i - 1; j >= 0 && port->storeAddr[j] > tempAddr; j--){
+			port->storeAddr[j + 1] = port->storeAddr[j];
+			port->storeData[j + 1] = port->storeData[j];
+		}
+		port->storeAddr[j + 1] = tempAddr;
+		port->storeData[j + 1] = tempData;
+	}
+
+	//one write message for each run of consecutive addresses
+	for(i = 0; i < port->numStores; i = j){
+		for(j = i + 1; j < port->numStores && port->storeAddr[j] == port->storeAddr[j - 1] + 1; j++);
+		stores[storeWords++] = MSG_WRITE;
+		stores[storeWords++] = port->storeAddr[i];
+		stores[storeWords++] = j - i;
+		memcpy(&stores[storeWords], &port->storeData[i], (j - i) * sizeof(int));
+		storeWords += j - i;
+	}
+	port->numStores = 0;
+
+	iov[0].iov_base = stores;
+	iov[0].iov_len = storeWords * sizeof(int);
+	iov[1].iov_base = message;
+	iov[1].iov_len = messageWords * sizeof(int);
+	if(iov[0].iov_len + iov[1].iov_len == 0)
+		return;
+	//at most PIPE_BUF bytes, so the pipe takes all of it at once
+	if(writev(port->writeFd, iov, 2) != (ssize_t)(iov[0].iov_len + iov[1].iov_len)){
+		if(errno == EPIPE)
+			memoryStopped();
+		error_exit("writev() failed");
+	}
+}
+
+//Reads count words answered by the memory into dst
+void portReceive(struct memoryPort *port, int *dst, int count){
+	size_t done = 0;
+	ssize_t bytes;
+
+	while(done < count * sizeof(int)){
+		bytes = read(port->readFd, (char *)dst + done, count * sizeof(int) - done);
+		if(bytes <= 0)
+			memoryStopped();
+		done += bytes;
+	}
+}
+
+/*
+* Looks for the word at address in the fetch window and the store buffer.
+* Returns 1 and stores the word in data if it was found, 0 otherwise.
+*/
+int portLookup(struct memoryPort *port, int address, int *data){
+	int i;
+
+	if(portInWindow(port, address)){
+		*data = port->fetchWords[address - port->fetchBase];
+		return 1;
+	}
+	for(i = 0; i < port->numStores; i++){
+		if(port->storeAddr[i] == address){
+			*data = port->storeData[i];
+			return 1;
+		}
+	}
+	return 0;
+}
+
+//Returns 1 if the word at address is in the fetch window, 0 otherwise
+int portInWindow(struct memoryPort *port, int address){
+	//subtract instead of adding, so addresses near INT_MAX cannot overflow
+	return address >= port->fetchBase && address - port->fetchBase < port->fetchCount;
+}
+
+/*
+* Returns how many words to fetch starting at address, FETCH_SIZE
+* but never past the end of memory. Addresses outside of memory
+* get 1 so the memory reports them.
+*/
+int portWindowSize(int address){
+	if(address < 0 || address > 1999)
+		return 1;
+	if(address > 2000 - FETCH_SIZE)
+		return 2000 - address;
+	return FETCH_SIZE;
+}
+
+/*
+* Returns the word at address for the instruction fetch. If it is not in the
+* fetch window, portWindowSize(address) words starting at address are read with
+* one message, so the operand and the next instructions usually need no message.
+*/
+int portFetch(struct memoryPort *port, int address){
+	int request[3];
+	int count;
+
+	port->prefetchAddr = -1;
+	if(portInWindow(port, address))
+		return port->fetchWords[address - port->fetchBase];
+
+	count = portWindowSize(address);
+	request[0] = MSG_READ;
+	request[1] = address;
+	request[2] = count;
+	portSend(port, request, 3);
+	portReceive(port, port->fetchWords, count);
+	port->fetchBase = address;
+	port->fetchCount = count;
+	return port->fetchWords[0];
+}
+
+/*
+* Tells the port where the next instruction will be fetched. If the next
+* data read has to ask the memory, the fetch window at address is asked for
+* in the same message, so both reads are in flight during one round trip.
+*/
+void portPrefetch(struct memoryPort *port, int address){
+	port->prefetchAddr = address;
+}
+
+//Returns the data word at address
+int portRead(struct memoryPort *port, int address){
+	int data;
+	portReadWords(port, address, 1, &data);
+	return data;
+}
+
+/*
+* Reads count consecutive words starting at address into dst.
+* Sends one read message unless all the words are in the
+* fetch window or the store buffer. A pending prefetch is
+* sent along with the read message.
+*/
+void portReadWords(struct memoryPort *port, int address, int count, int *dst){
+	int request[6] = {MSG_READ, address, count};
+	int requestWords = 3;
+	int prefetch = port->prefetchAddr;
+	int i;
+
+	//only look up addresses that are in memory, the memory reports the others
+	if(address >= 0 && address <= 2000 - count){
+		for(i = 0; i < count; i++){
+			if(!portLookup(port, address + i, &dst[i]))
+				break;
+		}
+		if(i == count)
+			return;
+	}
+
+	//the prefetch stays pending until a message is sent, so a later read can still take it
+	port->prefetchAddr = -1;
+
+	//ask for the next fetch window too, never for a window outside of memory
+	if(prefetch >= 0 && prefetch <= 1999 && !portInWindow(port, prefetch)){
+		request[3] = MSG_READ;
+		request[4] = prefetch;
+		request[5] = portWindowSize(prefetch);
+		requestWords = 6;
+	}
+
+	portSend(port, request, requestWords);
+	portReceive(port, dst, count);
+	if(requestWords == 6){
+		portReceive(port, port->fetchWords, request[5]);
+		port->fetchBase = prefetch;
+		port->fetchCount = request[5];
+	}
+}
+
+/*
+* Writes data at address through the store buffer. A second store to the
+* same address replaces the first one. The buffer is sent when it is full,
+* before the next read message, or right away if address is outside of memory
+* so the memory can report it.
+*/
+void portWrite(struct memoryPort *port, int address, int data){
+	int i;
+
+	//keep the fetch window up to date
+	if(portInWindow(port, address))
+		port->fetchWords[address - port->fetchBase] = data;
+
+	for(i = 0; i < port->numStores; i++){
+		if(port->storeAddr[i] == address){
+			port->storeData[i] = data;
+			return;
+		}
+	}
+
+	if(port->numStores == STORE_BUFFER_SIZE)
+		portSend(port, NULL, 0);
+	port->storeAddr[port->numStores] = address;
+	port->storeData[port->numStores] = data;
+	port->numStores++;
+
+	if(address < 0 || address > 1999)
+		portSend(port, NULL, 0);
+}
+
+//Sends the buffered stores and the end message
+void portClose(struct memoryPort *port){
+	int end[3] = {MSG_END, 0, 0};
+	portSend(port, end, 3);
+}
+
+/*
+* Called when the CPU stops on its own. Sends the buffered stores and the
+* end message, then writes the profile if there is one.
+*/
+void stopCPU(struct memoryPort *port){
+	portClose(port);
+	if(profileOut != NULL)
+		writeProfile();
+}
+
+/*
+* Called when the memory stopped after an error and closed its pipes.
+* Writes the profile if there is one and stops the CPU too.
+*/
+void memoryStopped(void){
+	if(profileOut != NULL)
+		writeProfile();
+	_exit(1);
+}
+
+/*
+* Runs the CPU until the END instruction. The CPU reads memory from readFd
+* and sends requests to the parent through writeFd. The last three parameters
+* are always constants, so each variant built by CPU_VARIANT only keeps the
+* code for the features it uses:
+* timer   - timer interrupts after timeToInterrupt instructions
+* protect - user mode cannot access system memory
+* profile - report the running instruction and routines to the profiler
+*/
+static inline ALWAYS_INLINE
+void runCPU(int readFd, int writeFd, int timeToInterrupt,
+	const int timer, const int protect, const int profile)
+{
+	//CPU variables
+	int interruptCounter = 0;//increases after execution of an instruction
+	int mode; // kernel mode(0), user mode(1)
+	int inInterrupt;//block interrupts when equal to 1
+	int SP, PC, IR, AC, X, Y;//CPU registers
+	int operand;//to store other data from program
+	int tempSP;//tem holder for stack pointer
+	int stack[2];//to store words popped with one read
+	struct memoryPort port;//connection to the memory
+
+	//initialize registers and variables
+	PC = 0;//point to the first instruction of program
+	SP = 999; //point to the begining of the user stack
+	AC = 0;
+	X = 0;
+	Y = 0;
+	operand = 0;
+	mode = 1; //user mode
+	inInterrupt = 0;//in interrupt to false
+
+	//tell the parent which protocol version the CPU speaks
+	portOpen(&port, readFd, writeFd);
+
+	//sample host CPU time per guest address
+	if(profile)
+		startProfiler();
+
+	//fetch the first instruction
+	if(profile)//the fetch belongs to the instruction being fetched
+		guestPC = PC;
+	IR = portFetch(&port, PC);//store the instruction into IR
+
+	//exit loop when the END(50) instruction is reached
+	while(IR != 50){
+		//do according to the instruction number
+		switch(IR){
+			//********************************************************
+			//		1.	Load value:	Load the value into the AC
+			//********************************************************
+			case 1: 
+				PC++; //increase PC by 1
+				//get the value to load into AC
+				AC = portFetch(&port, PC);//store value into AC
+				PC++;
+				break;
+
+			//*********************************************************
+			//	2. Load addr: Load the value at the address into the AC
+			//*********************************************************
+			case 2:
+				PC++; //increase PC by 1
+				//get the address
+				operand = portFetch(&port, PC);//store value into operand
+
+				//check for memory violation
+				if(protect && mode && (operand >= 1000)){
+					//flush the stores and send end signal so parent can stop waiting for signals
+					stopCPU(&port);
+					//display error message
+					printf("Memory violation: accessing system address %d in user mode\n", operand);
+					_exit(0);//terminate child process
+				}
+
+				//get the value to store into AC
+				portPrefetch(&port, PC + 1);//next instruction comes with the data
+				AC = portRead(&port, operand);//store value into AC
+				PC++;
+				break;
+
+			//********************************************************
+			//	3. LoadInd addr: Load the value from the address found 
+			// 	    in the given address into the AC
+			//********************************************************
+			case 3:
+				PC++; //increase PC by 1
+				//get the address
+				operand = portFetch(&port, PC);//store value into operand
+
+				//check for memory violation
+				if(protect && mode && (operand >= 1000)){
+					//flush the stores and send end signal so parent can stop waiting for signals
+					stopCPU(&port);
+					//display error message
+					printf("Memory violation: accessing system address %d in user mode\n", operand);
+					_exit(0);//terminate child process
+				}
+
+				//get the value at address stored in operand
+				portPrefetch(&port, PC + 1);//next instruction comes with the data
+				operand = portRead(&port, operand);//store value into operand again
+				//get the value at location stored in operand
+				AC = portRead(&port, operand);//store value into AC
+				PC++;
+				break;
+
+			//********************************************************
+			//	4. LoadIdxX addr: Load the value at (address+X) 
+			//	   into the AC
+			//********************************************************
+			case 4:
+				PC++; //increase PC by 1
+				//get the address
+				operand = portFetch(&port, PC);//store value into operand
+
+				//check for memory violation
+				if(protect && mode && (operand >= 1000)){
+					//flush the stores and send end signal so parent can stop waiting for signals
+					stopCPU(&port);
+					//display error message
+					printf("Memory violation: accessing system address %d in user mode\n", operand);
+					_exit(0);//terminate child process
+				}
+
+				//(address+X)
+				operand = operand + X;
+
+				//get the value at location operand from memory
+				portPrefetch(&port, PC + 1);//next instruction comes with the data
+				AC = portRead(&port, operand);//store value into AC
+				PC++;
+				break;
+
+			//********************************************************
+			//	5. LoadIdxY addr: Load the value at (address+Y)
+			//     into the AC
+			//********************************************************
+			case 5:
+				PC++; //increase PC by 1
+				//get the address
+				operand = portFetch(&port, PC);//store value into operand
+
+				//check for memory violation
+				if(protect && mode && (operand >= 1000)){
+					//flush the stores and send end signal so parent can stop waiting for signals
+					stopCPU(&port);
+					//display error message
+					printf("Memory violation: accessing system address %d in user mode\n", operand);
+					_exit(0);//terminate child process
+				}
+				
+				operand = operand + Y; ////(address+Y)
+
+				//get the value at location operand from memory
+				portPrefetch(&port, PC + 1);//next instruction comes with the data
+				AC = portRead(&port, operand);//store value into AC
+				PC++;
+				break;
+
+			//********************************************************
+			//	6. LoadSpX: Load from (SP+X) into the AC
+			//********************************************************
+			case 6:
+				PC++; //increase PC by 1
+				operand = SP + X; // (SP + X)
+				//get the value at location operand from memory
+				portPrefetch(&port, PC);//next instruction comes with the data
+				AC = portRead(&port, operand);//store value into AC
+				break;
+
+			//***********************************************************
+			//	7. Store addr: Store the value in the AC into the address
+			//***********************************************************
+			case 7:
+				PC++; //increase PC by 1
+				//get the addres
+				operand = portFetch(&port, PC);//store value into operand
+
+				//check for memory violation
+				if(protect && mode && (operand >= 1000)){
+					//flush the stores and send end signal so parent can stop waiting for signals
+					stopCPU(&port);
+					printf("Memory violation: accessing system address %d in user mode\n", operand);
+					_exit(0);
+				}
+
+				//write AC into memory through the store buffer
+				portWrite(&port, operand, AC);//store AC at operand
+				PC++;
+				break;
+
+			//********************************************************
+			//	8. Get: Gets a random int from 1 to 100 into the AC
+			//********************************************************
+			case 8: 
+				PC++; //increase PC by 1
+				srand(time(NULL));
+				AC = rand() % 101;//generate random number
+				if(AC == 0)//if 0 was generated change to 1
+					AC = 1;
+				break;
+
+			//********************************************************
+			//	9. Put port: Write AC as int or char depending on port
+			//********************************************************
+			case 9:
+				PC++; //increase PC by 1
+				//get the port
+				operand = portFetch(&port, PC);//store value into operand
+
+				//If port=1, write AC as an int to the screen
+				if(operand == 1){
+					printf("%d", AC);
+				}
+				//If port=2, write AC as a char to the screen
+				else if(operand == 2){
+					printf("%c", (char)AC);
+				}
+				PC++;
+				break;
+
+			//********************************************************
+			//	10. AddX: Add the value in X to the AC
+			//********************************************************
+			case 10: 
+				PC++; //increase PC by 1
+				AC = AC + X;
+				break;
+
+			//********************************************************
+			//	11. AddY: Add the value in Y to the AC
+			//********************************************************
+			case 11:
+				PC++; //increase PC by 1
+				AC = AC + Y;
+				break;
+
+			//********************************************************
+			//	12. SubX: Subtract the value in X from the AC
+			//********************************************************
+			case 12: 
+				PC++; //increase PC by 1
+				AC = AC - X;
+				break;
+
+			//********************************************************
+			//	13. SubY: Subtract the value in Y from the AC
+			//********************************************************
+			case 13: 
+				PC++; //increase PC by 1
+				AC = AC - Y;
+				break;
+
+			//********************************************************
+			//	14. CopyToX: Copy the value in the AC to X
+			//********************************************************
+			case 14:
+				PC++; //increase PC by 1
+				X = AC;
+				break;
+
+			//********************************************************
+			//	15. CopyFromX : Copy the value in X to the AC
+			//********************************************************
+			case 15:
+				PC++; //increase PC by 1
+				AC = X;
+				break;
+
+			//********************************************************
+			//	16. CopyToY: Copy the value in the AC to Y
+			//********************************************************
+			case 16: 
+				PC++; //increase PC by 1
+				Y = AC;
+				break;
+
+			//********************************************************
+			//	17. CopyFromY: Copy the value in Y to the AC
+			//********************************************************
+			case 17: 
+				PC++; //increase PC by 1
+				AC = Y;
+				break;
+
+			//********************************************************
+			//	18. CopyToSp: Copy the value in AC to the SP
+			//********************************************************
+			case 18:
+				PC++; //increase PC by 1
+				SP = AC;
+				break;
+
+			//********************************************************
+			//	19. CopyFromSp: Copy the value in SP to the AC
+			//********************************************************
+			case 19: 
+				PC++; //increase PC by 1
+				AC = SP;
+				break;
+
+			//********************************************************
+			//	20. Jump addr: Jump to the address
+			//********************************************************
+			case 20: 
+				PC++; //increase PC by 1
+				//get the address
+				operand = portFetch(&port, PC);//store value into operand
+				PC = operand; //value in operand is the new PC
+				break;
+
+			//********************************************************
+			//	21. JumpIfEqual addr: Jump to the address only 
+			//      if the value in the AC is zero
+			//********************************************************
+			case 21:
+				PC++; //increase PC by 1
+				if(AC == 0){
+					//get the address
+					operand = portFetch(&port, PC);//store value into operand
+					PC = operand;
+				}
+				else{
+					PC++; //increase PC by 1
+				}
+				break;
+
+			//********************************************************
+			//	22. JumpIfNotEqual addr: Jump to the address only 
+			//      if the value in the AC is not zero
+			//********************************************************
+			case 22: 
+				PC++; //increase PC by 1
+				//get the address
+				operand = portFetch(&port, PC);//store value into operand
+				if(AC != 0)
+					PC = operand;
+				else
+					PC++;
+				break;
+
+			//********************************************************
+			//	23. Call addr: Push return address onto stack, 
+			//      jump to the address
+			//********************************************************
+			case 23: 
+				PC++; //increase PC by 1
+				//get the address
+				operand = portFetch(&port, PC);//store value into operand
+
+				PC++; //return addres
+
+				//remember the routine entry for the profile
+				if(profile && operand >= 0 && operand < 2000)
+					routineEntry[operand] = 1;
+
+				//push return address onto user stack
+				SP--;//decrement stack pointer before push
+				portWrite(&port, SP, PC);//store PC at SP
+
+				PC = operand; // update PC to the intruction to jump to
+				break;
+
+			//********************************************************
+			//	24. Ret: Pop return address from the stack, 
+			//      jump to the address
+			//********************************************************
+			case 24:
+				PC++; //increase PC by 1
+				//pop return address from location at SP
+				PC = portRead(&port, SP);//store into PC 
+				SP++;//increment stack pointer after pop
+				break;
+
+			//********************************************************
+			//	25. IncX: Increment the value in X
+			//********************************************************
+			case 25: 
+				PC++; //increase PC by 1
+				X = X + 1;
+				break;
+
+			//********************************************************
+			//	26. DecX: Decrement the value in X
+			//********************************************************
+			case 26: 
+				PC++; //increase PC by 1
+				X = X - 1;
+				break;
+
+			//********************************************************
+			//	27. Push: Push AC onto stack
+			//********************************************************
+			case 27: 
+				PC++; //increase PC by 1
+				SP--;//decrement stack pointer before push
+				portWrite(&port, SP, AC);//store AC at SP
+				break;
+
+			//********************************************************
+			//	28. Pop: Pop from stack into AC
+			//********************************************************
+			case 28: 
+				PC++; //increase PC by 1
+				//pop value from stack at location SP and store it in AC
+				portPrefetch(&port, PC);//next instruction comes with the data
+				AC = portRead(&port, SP);//store value into AC
+				SP++;//increment stack pointer after pop
+				break;
+
+			//********************************************************
+			//	29. Int: Perform system call
+			//********************************************************
+			case 29: 
+				PC++; //increase PC by 1
+				if(inInterrupt)//avoid nested interrupts
+					break;
+
+				if(protect)//mode is only needed for the protection check
+					mode = 0; //enter kernel mode
+				tempSP = SP; //temporarily hold current stack pointer value
+				SP = 1999; //point to the system stack
+				inInterrupt = 1; //set in interrupt flag to avoid nested interrupts
+
+				//Save SP, PC onto the system stack
+				//push current SP value temporarily held in tempSP onto sys stack
+				SP--;//decrement stack pointer before push
+				portWrite(&port, SP, tempSP);//store tempSP at SP
+
+				//push current PC value onto sys stack
+				SP--;//decrement stack pointer before push
+				portWrite(&port, SP, PC);//store PC at SP
+
+				PC = 1500; //execute from address 1500
+				break;
+
+			//********************************************************
+			//	30. IRet: Return from interrupt
+			//********************************************************
+			case 30: 
+				//pop PC and user SP from sys stack with one read
+				portReadWords(&port, SP, 2, stack);
+				PC = stack[0];//PC was pushed last
+				tempSP = stack[1];//user SP was pushed first
+				SP += 2;//increment stack pointer after both pops
+
+				SP = tempSP;//point to the user stack
+
+				if(protect)//mode is only needed for the protection check
+					mode = 1; //chage to user mode
+				inInterrupt = 0; //enable interrupts
+				break;
+
+				default:
+					//invalid instruction
+					//send end signal
+					stopCPU(&port);
+					//print error message
+					error_exit("Invalid instruction");
+
+		}//end switch case statements
+
+		//if not currently executing an interrupt, increase counter
+		if(timer && !inInterrupt)
+			interruptCounter++;
+
+		//check for timer interrupts
+		if(timer && interruptCounter == timeToInterrupt){
+
+			if(inInterrupt){//avoid nested interrupts
+				//do nothing
+			}
+			else{
+				interruptCounter = -1;//reset counter
+				if(profile)//the interrupt entry is not part of any instruction
+					guestPC = -1;
+				if(protect)//mode is only needed for the protection check
+					mode = 0; //enter kernel mode
+				tempSP = SP; //temporarily hold current stack pointer value
+				SP = 1999; //point to the system stack
+				inInterrupt = 1; //set in interrupt flag to avoid nested interrupts
+
+				//Save SP, PC and the system stack
+				//push current SP value temporarily held in tempSP onto sys stack
+				SP--; //decrement stack pointer before push
+				portWrite(&port, SP, tempSP);//store tempSP at SP
+
+				//push current PC value onto sys stack
+				SP--; //decrement stack pointer before push
+				portWrite(&port, SP, PC);//store PC at SP
+
+				PC = 1000; //execute from address 1000
+			}
+		}
+
+		//fetch the next instruction
+		if(profile)//the fetch belongs to the instruction being fetched
+			guestPC = PC;
+		IR = portFetch(&port, PC);//store the instruction into IR
+
+	}//end while loop
+
+	//flush the stores and send end signal so parent can stop waiting for signals
+	stopCPU(&port);
+}
+
+//Defines a CPU variant with the given features compiled in
+#define CPU_VARIANT(name, timer, protect, profile) \
+	void name(int readFd, int writeFd, int timeToInterrupt){ \
+		runCPU(readFd, writeFd, timeToInterrupt, timer, protect, profile); \
+	}
+
+CPU_VARIANT(cpuPlain, 0, 0, 0)
+CPU_VARIANT(cpuTimer, 1, 0, 0)
+CPU_VARIANT(cpuProtect, 0, 1, 0)
+CPU_VARIANT(cpuTimerProtect, 1, 1, 0)
+CPU_VARIANT(cpuProfile, 0, 0, 1)
+CPU_VARIANT(cpuTimerProfile, 1, 0, 1)
+CPU_VARIANT(cpuProtectProfile, 0, 1, 1)
+CPU_VARIANT(cpuTimerProtectProfile, 1, 1, 1)
+
+/*
+* Returns the CPU variant that has exactly the features
+* turned on by the command line options.
+*/
+cpuFunction selectCPU(int timer, int protect, int profile){
+	cpuFunction variants[8] = {
+		cpuPlain, cpuTimer, cpuProtect, cpuTimerProtect,
+		cpuProfile, cpuTimerProfile, cpuProtectProfile, cpuTimerProtectProfile
+	};
+	return variants[(timer ? 1 : 0) + (protect ? 2 : 0) + (profile ? 4 : 0)];
+}
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Runs the guest programs in tests/ and compares their output and exit
+# status with the matching .expected file. Run from the repository root:
+#   sh tests/run_tests.sh
+# CC can be set to pick the compiler, cc is used by default.
+
+CC=${CC:-cc}
+build=$(mktemp -d) || exit 1
+trap 'rm -rf "$build"' EXIT
+
+"$CC" -o "$build/simulation" simulation.c || exit 1
+#CPU that sends an old protocol version, the memory must refuse it
+"$CC" -DCPU_PROTOCOL_VERSION=1 -o "$build/simulation_v1" simulation.c || exit 1
+
+failed=0
+
+#check name command... runs the command and compares with tests/name.expected
+check(){
+	name=$1
+	shift
+	"$@" > "$build/$name.out" 2>&1
+	echo "exit $?" >> "$build/$name.out"
+	if cmp -s "$build/$name.out" "tests/$name.expected"; then
+		echo "ok   $name"
+	else
+		echo "FAIL $name"
+		diff "tests/$name.expected" "$build/$name.out"
+		failed=1
+	fi
+}
+
+check sample5 "$build/simulation" sample5.txt 30
+check store_load "$build/simulation" tests/store_load.txt 0
+check selfmod "$build/simulation" tests/selfmod.txt 0
+check stack_top "$build/simulation" tests/stack_top.txt 0
+check negative_address "$build/simulation" tests/negative_address.txt 0
+check intmax_loadidx "$build/simulation" tests/intmax_loadidx.txt 0
+check intmax_store "$build/simulation" -u tests/intmax_store.txt 0
+check intmax_jump "$build/simulation" tests/intmax_jump.txt 0
+check version "$build/simulation_v1" sample5.txt 30
+
+exit $failed